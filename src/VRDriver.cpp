@@ -1,6 +1,7 @@
 #include "VRDriver.hpp"
 #include <TrackerDevice.hpp>
 #include "bridge/bridge.hpp"
+#include "bridge/bridge-framing.hpp"
 #include "TrackerRole.hpp"
 #include <google/protobuf/arena.h>
 #include <simdjson.h>
@@ -28,6 +29,24 @@ vr::EVRInitError SlimeVRDriver::VRDriver::Init(vr::IVRDriverContext* pDriverCont
         Log(ss.str());
     }
 
+    SettingsValue fast_hmd = GetSettingsValue("fastHmdPoseEncoding");
+    if (std::holds_alternative<bool>(fast_hmd)) {
+        fast_hmd_pose_encoding_ = std::get<bool>(fast_hmd);
+    } else if (std::holds_alternative<int>(fast_hmd)) {
+        fast_hmd_pose_encoding_ = std::get<int>(fast_hmd) != 0;
+    }
+
+    // Debug: tee all received bridge messages into a file for replay
+    SettingsValue recording_path = GetSettingsValue("recordBridgeTraffic");
+    if (std::holds_alternative<std::string>(recording_path) && !std::get<std::string>(recording_path).empty()) {
+        bridge_recording_.open(std::get<std::string>(recording_path), std::ios::binary | std::ios::trunc);
+        if (bridge_recording_.is_open()) {
+            Log("Recording bridge traffic to " + std::get<std::string>(recording_path));
+        } else {
+            Log("Failed to open bridge recording " + std::get<std::string>(recording_path));
+        }
+    }
+
     Log("SlimeVR Driver Loaded Successfully");
 
     return vr::VRInitError_None;
@@ -64,6 +83,9 @@ void SlimeVRDriver::VRDriver::RunFrame()
         messages::ProtobufMessage* message = google::protobuf::Arena::CreateMessage<messages::ProtobufMessage>(&arena);
         // Read all messages from the bridge
         while(getNextBridgeMessage(*message, *this)) {
+            if(bridge_recording_.is_open())
+                RecordBridgeMessage(*message);
+
             if(message->has_tracker_added()) {
                 messages::TrackerAdded ta = message->tracker_added();
                 switch(getDeviceType(static_cast<TrackerRole>(ta.tracker_role()))) {
@@ -87,6 +109,10 @@ void SlimeVRDriver::VRDriver::RunFrame()
             }
         }
 
+        // An empty message marks the end of this frame's messages in the recording
+        if(bridge_recording_.is_open())
+            RecordBridgeMessage(messages::ProtobufMessage::default_instance());
+
         if(!sentHmdAddMessage) {
             // Send add message for HMD
             messages::TrackerAdded* trackerAdded = google::protobuf::Arena::CreateMessage<messages::TrackerAdded>(&arena);
@@ -153,20 +179,25 @@ void SlimeVRDriver::VRDriver::RunFrame()
             pos.v[2] = pos_z;
         }
 
-        messages::Position* hmdPosition = google::protobuf::Arena::CreateMessage<messages::Position>(&arena);
-        message->set_allocated_position(hmdPosition);
-
-        hmdPosition->set_tracker_id(0);
-        hmdPosition->set_data_source(messages::Position_DataSource_FULL);
-        hmdPosition->set_x(pos.v[0]);
-        hmdPosition->set_y(pos.v[1]);
-        hmdPosition->set_z(pos.v[2]);
-        hmdPosition->set_qx((float) q.x);
-        hmdPosition->set_qy((float) q.y);
-        hmdPosition->set_qz((float) q.z);
-        hmdPosition->set_qw((float) q.w);
+        // Fast path: patch the floats into the pre-encoded HMD frame
+        if (fast_hmd_pose_encoding_ && hmd_position_encoder_.Encode(pos.v[0], pos.v[1], pos.v[2], (float) q.x, (float) q.y, (float) q.z, (float) q.w)) {
+            sendBridgeFrame(hmd_position_encoder_.Data(), hmd_position_encoder_.Size(), *this);
+        } else {
+            messages::Position* hmdPosition = google::protobuf::Arena::CreateMessage<messages::Position>(&arena);
+            message->set_allocated_position(hmdPosition);
+
+            hmdPosition->set_tracker_id(0);
+            hmdPosition->set_data_source(messages::Position_DataSource_FULL);
+            hmdPosition->set_x(pos.v[0]);
+            hmdPosition->set_y(pos.v[1]);
+            hmdPosition->set_z(pos.v[2]);
+            hmdPosition->set_qx((float) q.x);
+            hmdPosition->set_qy((float) q.y);
+            hmdPosition->set_qz((float) q.z);
+            hmdPosition->set_qw((float) q.w);
 
-        sendBridgeMessage(*message, *this);
+            sendBridgeMessage(*message, *this);
+        }
     } else {
         // If bridge not connected, assume we need to resend hmd tracker add message
         sentHmdAddMessage = false;
@@ -174,6 +205,18 @@ void SlimeVRDriver::VRDriver::RunFrame()
     }
 }
 
+void SlimeVRDriver::VRDriver::RecordBridgeMessage(const messages::ProtobufMessage &message)
+{
+    std::array<uint8_t, 1024> frame;
+    const auto msgSize = static_cast<int>(message.ByteSizeLong());
+    const std::optional msgBegin = WriteBridgeHeader(frame.begin(), static_cast<int>(frame.size()), msgSize);
+    if (!msgBegin || !message.SerializeToArray(&(**msgBegin), msgSize)) {
+        Log("Failed to record bridge message");
+        return;
+    }
+    bridge_recording_.write(reinterpret_cast<const char*>(frame.data()), msgSize + BRIDGE_HEADER_SIZE);
+}
+
 bool SlimeVRDriver::VRDriver::ShouldBlockStandbyMode()
 {
     return false;
@@ -256,11 +299,11 @@ SlimeVRDriver::SettingsValue SlimeVRDriver::VRDriver::GetSettingsValue(std::stri
     if (err == vr::EVRSettingsError::VRSettingsError_None) {
         return bool_value;
     }
-    std::string str_value;
-    str_value.reserve(1024);
-    vr::VRSettings()->GetString(settings_key_.c_str(), key.c_str(), str_value.data(), 1024, &err);
+    err = vr::EVRSettingsError::VRSettingsError_None;
+    char str_value[1024];
+    vr::VRSettings()->GetString(settings_key_.c_str(), key.c_str(), str_value, sizeof(str_value), &err);
     if (err == vr::EVRSettingsError::VRSettingsError_None) {
-        return str_value;
+        return std::string(str_value);
     }
     err = vr::EVRSettingsError::VRSettingsError_None;
 
@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <optional>
+#include <fstream>
 
 #include <openvr_driver.h>
 
@@ -12,6 +13,8 @@
 
 #include <simdjson.h>
 
+#include "bridge/HmdPositionEncoder.hpp"
+
 namespace SlimeVRDriver {
     class VRDriver : public IVRDriver {
     public:
@@ -52,6 +55,11 @@ namespace SlimeVRDriver {
         vr::HmdVector3_t GetPosition(vr::HmdMatrix34_t &matrix);
 
         bool sentHmdAddMessage = false;
+        HmdPositionEncoder hmd_position_encoder_;
+        bool fast_hmd_pose_encoding_ = true;
+
+        std::ofstream bridge_recording_;
+        void RecordBridgeMessage(const messages::ProtobufMessage &message);
 
         simdjson::ondemand::parser json_parser;
         std::optional<std::string> default_chap_path_ = std::nullopt;
@@ -0,0 +1,112 @@
+/*
+    SlimeVR Code is placed under the MIT license
+    Copyright (c) 2021 Eiren Rain
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+/**
+ * Pre-encoded bridge frame for the HMD Position message that the driver
+ * sends every frame. The message always has the same shape, so the length
+ * header, oneof tag and field tags are written once and only the float
+ * payloads are patched in place.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include "ProtobufMessages.pb.h"
+#include "bridge-framing.hpp"
+
+// The frame layout below depends on these, a .proto change must be reflected here
+static_assert(messages::ProtobufMessage::kPositionFieldNumber == 1, "HmdPositionEncoder: oneof tag changed");
+static_assert(messages::Position::kTrackerIdFieldNumber == 1, "HmdPositionEncoder: tracker_id must precede the floats");
+static_assert(messages::Position::kXFieldNumber == 2
+    && messages::Position::kYFieldNumber == 3
+    && messages::Position::kZFieldNumber == 4
+    && messages::Position::kQxFieldNumber == 5
+    && messages::Position::kQyFieldNumber == 6
+    && messages::Position::kQzFieldNumber == 7
+    && messages::Position::kQwFieldNumber == 8, "HmdPositionEncoder: float fields must be 2-8 in order");
+static_assert(messages::Position::kDataSourceFieldNumber == 9, "HmdPositionEncoder: data_source must follow the floats");
+static_assert(messages::Position_DataSource_FULL == 3, "HmdPositionEncoder: DataSource FULL value changed");
+
+class HmdPositionEncoder {
+public:
+    HmdPositionEncoder() {
+        auto it = *WriteBridgeHeader(mFrame.begin(), FRAME_SIZE, FRAME_SIZE - BRIDGE_HEADER_SIZE);
+        // ProtobufMessage.position
+        *(it++) = Tag(messages::ProtobufMessage::kPositionFieldNumber, WIRE_LEN);
+        *(it++) = static_cast<uint8_t>(POSITION_SIZE);
+        // Position.x .. Position.qw (fields 2-8); tracker_id = 0 is never serialized
+        for (uint32_t field = messages::Position::kXFieldNumber; field <= messages::Position::kQwFieldNumber; field++) {
+            *(it++) = Tag(field, WIRE_FIXED32);
+            it += 4;
+        }
+        // Position.data_source
+        *(it++) = Tag(messages::Position::kDataSourceFieldNumber, WIRE_VARINT);
+        *(it++) = static_cast<uint8_t>(messages::Position_DataSource_FULL);
+    }
+
+    /// Patch the pose into the pre-encoded frame.
+    /// Protobuf omits rotation components equal to zero, which changes the
+    /// message shape, so those poses have to go through sendBridgeMessage.
+    /// @return false if the pose can't be represented by this frame
+    bool Encode(float x, float y, float z, float qx, float qy, float qz, float qw) {
+        if (qx == 0.0f || qy == 0.0f || qz == 0.0f || qw == 0.0f) return false;
+        WriteFixed32(0, x);
+        WriteFixed32(1, y);
+        WriteFixed32(2, z);
+        WriteFixed32(3, qx);
+        WriteFixed32(4, qy);
+        WriteFixed32(5, qz);
+        WriteFixed32(6, qw);
+        return true;
+    }
+
+    const uint8_t* Data() const { return mFrame.data(); }
+    int Size() const { return FRAME_SIZE; }
+
+private:
+    static constexpr uint32_t WIRE_VARINT = 0;
+    static constexpr uint32_t WIRE_LEN = 2;
+    static constexpr uint32_t WIRE_FIXED32 = 5;
+    /// 7 x (tag + fixed32) + data_source tag and value
+    static constexpr int POSITION_SIZE = 7 * 5 + 2;
+    static constexpr int FRAME_SIZE = BRIDGE_HEADER_SIZE + 2 + POSITION_SIZE;
+    /// offset of the first float payload, after header, oneof tag/length and first field tag
+    static constexpr int FLOATS_OFFSET = BRIDGE_HEADER_SIZE + 2 + 1;
+
+    static constexpr uint8_t Tag(uint32_t field, uint32_t wireType) {
+        return static_cast<uint8_t>((field << 3U) | wireType);
+    }
+
+    /// write little-endian float payload of the n-th fixed32 field
+    void WriteFixed32(int n, float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint8_t* it = mFrame.data() + FLOATS_OFFSET + n * 5;
+        it[0] = static_cast<uint8_t>(bits);
+        it[1] = static_cast<uint8_t>(bits >> 8U);
+        it[2] = static_cast<uint8_t>(bits >> 16U);
+        it[3] = static_cast<uint8_t>(bits >> 24U);
+    }
+
+    std::array<uint8_t, FRAME_SIZE> mFrame{};
+};
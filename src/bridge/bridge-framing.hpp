@@ -0,0 +1,66 @@
+/*
+    SlimeVR Code is placed under the MIT license
+    Copyright (c) 2021 Eiren Rain
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+/**
+ * Length header framing shared by every bridge transport: each message is
+ * prefixed with its total size, including the header, as a 32 bit little
+ * endian integer.
+ */
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+inline constexpr int BRIDGE_HEADER_SIZE = 4;
+
+/// @return iterator after header
+template <typename TBufIt>
+std::optional<TBufIt> WriteBridgeHeader(TBufIt bufBegin, int bufSize, int msgSize) {
+    const int totalSize = msgSize + BRIDGE_HEADER_SIZE; // include header bytes in total size
+    if (bufSize < totalSize) return std::nullopt; // header won't fit
+
+    const auto size = static_cast<uint32_t>(totalSize);
+    TBufIt it = bufBegin;
+    *(it++) = static_cast<uint8_t>(size);
+    *(it++) = static_cast<uint8_t>(size >> 8U);
+    *(it++) = static_cast<uint8_t>(size >> 16U);
+    *(it++) = static_cast<uint8_t>(size >> 24U);
+    return it;
+}
+
+/// @return iterator after header
+template <typename TBufIt>
+std::optional<TBufIt> ReadBridgeHeader(TBufIt bufBegin, int numBytesRecv, int& outMsgSize) {
+    if (numBytesRecv < BRIDGE_HEADER_SIZE) return std::nullopt; // header won't fit
+
+    uint32_t size = 0;
+    TBufIt it = bufBegin;
+    size = static_cast<uint32_t>(static_cast<uint8_t>(*(it++)));
+    size |= static_cast<uint32_t>(static_cast<uint8_t>(*(it++))) << 8U;
+    size |= static_cast<uint32_t>(static_cast<uint8_t>(*(it++))) << 16U;
+    size |= static_cast<uint32_t>(static_cast<uint8_t>(*(it++))) << 24U;
+
+    const auto totalSize = static_cast<int>(size);
+    if (totalSize < BRIDGE_HEADER_SIZE) return std::nullopt;
+    outMsgSize = totalSize - BRIDGE_HEADER_SIZE;
+    return it;
+}
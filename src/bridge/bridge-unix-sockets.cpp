@@ -27,6 +27,7 @@
 #include "bridge.hpp"
 #ifdef __linux__
 #include "unix-sockets.hpp"
+#include "bridge-framing.hpp"
 #include <string_view>
 #include <memory>
 
@@ -34,40 +35,6 @@
 
 namespace {
 
-inline constexpr int HEADER_SIZE = 4;
-/// @return iterator after header
-template <typename TBufIt>
-std::optional<TBufIt> WriteHeader(TBufIt bufBegin, int bufSize, int msgSize) {
-    const int totalSize = msgSize + HEADER_SIZE; // include header bytes in total size
-    if (bufSize < totalSize) return std::nullopt; // header won't fit
-
-    const auto size = static_cast<uint32_t>(totalSize);
-    TBufIt it = bufBegin;
-    *(it++) = static_cast<uint8_t>(size);
-    *(it++) = static_cast<uint8_t>(size >> 8U);
-    *(it++) = static_cast<uint8_t>(size >> 16U);
-    *(it++) = static_cast<uint8_t>(size >> 24U);
-    return it;
-}
-
-/// @return iterator after header
-template <typename TBufIt>
-std::optional<TBufIt> ReadHeader(TBufIt bufBegin, int numBytesRecv, int& outMsgSize) {
-    if (numBytesRecv < HEADER_SIZE) return std::nullopt; // header won't fit
-
-    uint32_t size = 0;
-    TBufIt it = bufBegin;
-    size = static_cast<uint32_t>(*(it++));
-    size |= static_cast<uint32_t>(*(it++)) << 8U;
-    size |= static_cast<uint32_t>(*(it++)) << 16U;
-    size |= static_cast<uint32_t>(*(it++)) << 24U;
-
-    const auto totalSize = static_cast<int>(size);
-    if (totalSize < HEADER_SIZE) return std::nullopt;
-    outMsgSize = totalSize - HEADER_SIZE;
-    return it;
-}
-
 BasicLocalClient client{};
 
 inline constexpr int BUFFER_SIZE = 1024;
@@ -79,14 +46,14 @@ ByteBuffer byteBuffer;
 bool getNextBridgeMessage(messages::ProtobufMessage& message, SlimeVRDriver::VRDriver& driver) {
     if (!client.IsOpen()) return false;
 
-    int bytesRecv = client.Recv(byteBuffer.begin(), HEADER_SIZE);
+    int bytesRecv = client.Recv(byteBuffer.begin(), BRIDGE_HEADER_SIZE);
     if (bytesRecv == 0) return false; // no message waiting
 
     std::string dbg = "bridge debug: recv ";
     dbg += std::to_string(bytesRecv) + "b: ";
 
     int bytesToRead = 0;
-    const std::optional msgBeginIt = ReadHeader(byteBuffer.begin(), bytesRecv, bytesToRead);
+    const std::optional msgBeginIt = ReadBridgeHeader(byteBuffer.begin(), bytesRecv, bytesToRead);
     if (!msgBeginIt) {
         driver.Log("bridge recv error: invalid message header or size");
         return false;
@@ -142,27 +109,28 @@ bool sendBridgeMessage(messages::ProtobufMessage& message, SlimeVRDriver::VRDriv
     const auto bufBegin = byteBuffer.begin();
     const auto bufferSize = static_cast<int>(std::distance(bufBegin, byteBuffer.end()));
     const auto msgSize = static_cast<int>(message.ByteSizeLong());
-    const std::optional msgBeginIt = WriteHeader(bufBegin, bufferSize, msgSize);
+    const std::optional msgBeginIt = WriteBridgeHeader(bufBegin, bufferSize, msgSize);
     if (!msgBeginIt) {
-        driver.Log("bridge send error: failed to write header");
+        driver.Log("bridge send error: message too big");
         return false;
     }
     if (!message.SerializeToArray(&(**msgBeginIt), msgSize)) {
         driver.Log("bridge send error: failed to serialize");
         return false;
     }
-    int bytesToSend = static_cast<int>(std::distance(bufBegin, *msgBeginIt + msgSize));
-    if (bytesToSend <= 0) {
-        driver.Log("bridge send error: empty message");
-        return false;
-    }
-    if (bytesToSend > bufferSize) {
-        driver.Log("bridge send error: message too big");
+    const int bytesToSend = msgSize + BRIDGE_HEADER_SIZE;
+    driver.Log("bridge debug: send " + std::to_string(bytesToSend) + "b");
+    return sendBridgeFrame(byteBuffer.data(), bytesToSend, driver);
+}
+
+bool sendBridgeFrame(const uint8_t* frame, int size, SlimeVRDriver::VRDriver& driver) {
+    if (!client.IsOpen()) return false;
+    if (size < BRIDGE_HEADER_SIZE) {
+        driver.Log("bridge send error: invalid frame size");
         return false;
     }
     try {
-        driver.Log("bridge debug: send " + std::to_string(bytesToSend) + "b");
-        return client.Send(bufBegin, bytesToSend);
+        return client.Send(frame, size);
     } catch (const std::exception& e) {
         client.Close();
         driver.Log("bridge send error: " + std::string(e.what()));
@@ -27,6 +27,7 @@
 #include "bridge.hpp"
 #if defined(WIN32) && defined(BRIDGE_USE_PIPES)
 #include <windows.h>
+#include "bridge-framing.hpp"
 
 #define PIPE_NAME "\\\\.\\pipe\\SlimeVRDriver"
 
@@ -86,18 +87,28 @@ bool getNextBridgeMessage(messages::ProtobufMessage &message, SlimeVRDriver::VRD
 
 bool sendBridgeMessage(messages::ProtobufMessage &message, SlimeVRDriver::VRDriver &driver) {
     if(currentBridgeStatus == BRIDGE_CONNECTED) {
-        uint32_t size = (uint32_t) message.ByteSizeLong();
-        if(size > 1020) {
+        int size = (int) message.ByteSizeLong();
+        std::optional<char *> msgBegin = WriteBridgeHeader(buffer, (int) sizeof(buffer), size);
+        if(!msgBegin) {
             driver.Log("Message too big");
             return false;
         }
-        message.SerializeToArray(buffer + 4, size);
-        size += 4;
-        buffer[0] = size & 0xFF;
-        buffer[1] = (size >> 8) & 0xFF;
-        buffer[2] = (size >> 16) & 0xFF;
-        buffer[3] = (size >> 24) & 0xFF;
-        if(WriteFile(pipe, buffer, size, NULL, NULL)) {
+        if(!message.SerializeToArray(*msgBegin, size)) {
+            driver.Log("Failed to serialize message");
+            return false;
+        }
+        return sendBridgeFrame(reinterpret_cast<const uint8_t *>(buffer), size + BRIDGE_HEADER_SIZE, driver);
+    }
+    return false;
+}
+
+bool sendBridgeFrame(const uint8_t *frame, int size, SlimeVRDriver::VRDriver &driver) {
+    if(currentBridgeStatus == BRIDGE_CONNECTED) {
+        if(size < BRIDGE_HEADER_SIZE) {
+            driver.Log("Invalid frame size");
+            return false;
+        }
+        if(WriteFile(pipe, frame, size, NULL, NULL)) {
             return true;
         }
         currentBridgeStatus = BRIDGE_ERROR;
@@ -42,4 +42,7 @@ BridgeStatus runBridgeFrame(SlimeVRDriver::VRDriver &driver);
 
 bool getNextBridgeMessage(messages::ProtobufMessage &message, SlimeVRDriver::VRDriver &driver);
 
-bool sendBridgeMessage(messages::ProtobufMessage &message, SlimeVRDriver::VRDriver &driver);
\ No newline at end of file
+bool sendBridgeMessage(messages::ProtobufMessage &message, SlimeVRDriver::VRDriver &driver);
+
+/// Send an already framed message, including the 4 byte length header
+bool sendBridgeFrame(const uint8_t *frame, int size, SlimeVRDriver::VRDriver &driver);
\ No newline at end of file
@@ -0,0 +1,726 @@
+/*
+    SlimeVR Code is placed under the MIT license
+    Copyright (c) 2021 Eiren Rain
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+/**
+ * Golden-output equivalence harness: runs the same traffic through the
+ * reference path and an optimised path and reports every divergence.
+ *
+ * Usage:
+ *   EquivalenceHarness hmd-encoder
+ *   EquivalenceHarness replay [recording]
+ *
+ * replay runs bridge traffic through VRDriver::RunFrame against a fake
+ * SteamVR, once with fastHmdPoseEncoding off (reference) and once with it on
+ * (optimised), and diffs every DriverPose_t submitted per tracker and frame
+ * and every byte sent back to the server. Recordings are written by the
+ * driver itself when the recordBridgeTraffic setting is set; without one,
+ * synthetic traffic is generated.
+ */
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <openvr_driver.h>
+
+#include "bridge/HmdPositionEncoder.hpp"
+#include "bridge/bridge-framing.hpp"
+#include "bridge/bridge.hpp"
+#include "DriverFactory.hpp"
+#include "ProtobufMessages.pb.h"
+#include "TrackerRole.hpp"
+#include "VRDriver.hpp"
+
+namespace {
+
+/// Bridge messages framed like sendBridgeMessage, back to back.
+/// An empty message marks the end of a driver frame, see VRDriver::RecordBridgeMessage
+using Traffic = std::vector<uint8_t>;
+
+/// Appends the message to the stream, framed like sendBridgeMessage
+bool AppendFrame(const messages::ProtobufMessage& message, Traffic& stream) {
+    const auto msgSize = static_cast<int>(message.ByteSizeLong());
+    const size_t begin = stream.size();
+    stream.resize(begin + BRIDGE_HEADER_SIZE + msgSize);
+    const std::optional msgBegin = WriteBridgeHeader(stream.begin() + begin, BRIDGE_HEADER_SIZE + msgSize, msgSize);
+    return msgBegin && message.SerializeToArray(&(**msgBegin), msgSize);
+}
+
+//-----------------------------------------------------------------------------
+// hmd-encoder: HmdPositionEncoder against SerializeToArray, byte for byte
+//-----------------------------------------------------------------------------
+
+/// Reference path: the generic protobuf message RunFrame falls back to, framed like sendBridgeMessage
+int SerializeHmdPosition(const std::array<float, 7>& pose, std::array<uint8_t, 1024>& out) {
+    messages::ProtobufMessage message;
+    messages::Position* position = message.mutable_position();
+    position->set_tracker_id(0);
+    position->set_data_source(messages::Position_DataSource_FULL);
+    position->set_x(pose[0]);
+    position->set_y(pose[1]);
+    position->set_z(pose[2]);
+    position->set_qx(pose[3]);
+    position->set_qy(pose[4]);
+    position->set_qz(pose[5]);
+    position->set_qw(pose[6]);
+
+    const auto msgSize = static_cast<int>(message.ByteSizeLong());
+    const std::optional msgBegin = WriteBridgeHeader(out.begin(), static_cast<int>(out.size()), msgSize);
+    if (!msgBegin || !message.SerializeToArray(&(**msgBegin), msgSize)) return -1;
+    return msgSize + BRIDGE_HEADER_SIZE;
+}
+
+/// Compares HmdPositionEncoder against SerializeToArray byte for byte
+int RunHmdEncoder() {
+    const float special[] = {
+        0.0f, -0.0f, 1.0f, -1.0f,
+        std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::min(),
+        std::numeric_limits<float>::max(),
+    };
+    constexpr int numSpecial = sizeof(special) / sizeof(special[0]);
+
+    std::vector<std::array<float, 7>> poses;
+    // every special value in every component, the rest a plausible pose
+    for (int component = 0; component < 7; component++) {
+        for (int s = 0; s < numSpecial; s++) {
+            std::array<float, 7> pose = { 0.1f, 1.6f, -0.2f, 0.1f, 0.2f, 0.3f, 0.9f };
+            pose[component] = special[s];
+            poses.push_back(pose);
+        }
+    }
+    // HMD at the origin, rotation well defined
+    poses.push_back({ 0.0f, 0.0f, 0.0f, 0.5f, 0.5f, 0.5f, 0.5f });
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-3.0f, 3.0f);
+    for (int n = 0; n < 100000; n++) {
+        std::array<float, 7> pose;
+        for (auto& v : pose) v = dist(rng);
+        poses.push_back(pose);
+    }
+
+    HmdPositionEncoder encoder;
+    std::array<uint8_t, 1024> expected;
+    int failures = 0;
+    int fallbacks = 0;
+    for (size_t n = 0; n < poses.size(); n++) {
+        const auto& pose = poses[n];
+        const bool zeroRotation = pose[3] == 0.0f || pose[4] == 0.0f || pose[5] == 0.0f || pose[6] == 0.0f;
+        const bool encoded = encoder.Encode(pose[0], pose[1], pose[2], pose[3], pose[4], pose[5], pose[6]);
+        if (!encoded) {
+            fallbacks++;
+            if (!zeroRotation) {
+                std::printf("hmd-encoder: pose %zu: fell back without a zero rotation component\n", n);
+                failures++;
+            }
+            continue;
+        }
+        if (zeroRotation) {
+            std::printf("hmd-encoder: pose %zu: encoded a zero rotation component\n", n);
+            failures++;
+            continue;
+        }
+
+        const int size = SerializeHmdPosition(pose, expected);
+        if (size != encoder.Size()) {
+            std::printf("hmd-encoder: pose %zu: size %d (expected %d)\n", n, encoder.Size(), size);
+            failures++;
+            continue;
+        }
+        const uint8_t* actual = encoder.Data();
+        for (int i = 0; i < size; i++) {
+            if (actual[i] != expected[i]) {
+                std::printf("hmd-encoder: pose %zu: byte %d = %d (expected %d)\n", n, i, actual[i], expected[i]);
+                failures++;
+                break;
+            }
+        }
+    }
+
+    std::printf("hmd-encoder: %zu poses, %d fallbacks, %d divergences\n", poses.size(), fallbacks, failures);
+    return failures == 0 ? 0 : 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// replay: bridge traffic through the real VRDriver, reference against optimised
+//-----------------------------------------------------------------------------
+
+struct SubmittedPose {
+    int frame;
+    vr::DriverPose_t pose;
+};
+
+/// Poses submitted through TrackedDevicePoseUpdated, by tracker serial
+using Capture = std::map<std::string, std::vector<SubmittedPose>>;
+
+struct RunResult {
+    Capture poses;
+    /// bytes sent to the server, by driver frame
+    std::vector<Traffic> sent;
+    int preEncodedFrames = 0;
+    int genericHmdPositions = 0;
+    int viveRoles = 0;
+    int badStructSizes = 0;
+};
+
+/// What the in-memory bridge and the fake SteamVR are working on
+struct Replay {
+    const Traffic* traffic = nullptr;
+    size_t offset = 0;
+    int frame = 0;
+    RunResult* result = nullptr;
+};
+
+Replay replay;
+std::shared_ptr<SlimeVRDriver::VRDriver> replayDriver;
+
+/// HMD pose for the frame: turning and nodding, with an identity rotation every 50 frames
+/// so the zero rotation components take the generic path in both configurations
+vr::HmdMatrix34_t HmdPose(int frame) {
+    const bool identity = frame % 50 == 0;
+    const float yaw = identity ? 0.0f : 0.02f * frame;
+    const float pitch = identity ? 0.0f : 0.3f * std::sin(0.05f * frame);
+    const float cy = std::cos(yaw), sy = std::sin(yaw);
+    const float cp = std::cos(pitch), sp = std::sin(pitch);
+    // yaw around Y after pitch around X
+    const vr::HmdMatrix34_t matrix = { {
+        { cy, sy * sp, sy * cp, 0.1f * std::sin(0.01f * frame) },
+        { 0.0f, cp, -sp, 1.7f },
+        { -sy, cy * sp, cy * cp, -0.2f * std::cos(0.01f * frame) },
+    } };
+    return matrix;
+}
+
+class FakeServerDriverHost : public vr::IVRServerDriverHost {
+public:
+    /// serial of each added device, device index 0 is the HMD
+    std::vector<std::string> serials = { "HMD" };
+
+    virtual bool TrackedDeviceAdded(const char* pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver* pDriver) override {
+        // SteamVR refuses a serial it already knows
+        if (std::find(serials.begin(), serials.end(), pchDeviceSerialNumber) != serials.end()) return false;
+        const auto index = static_cast<vr::TrackedDeviceIndex_t>(serials.size());
+        serials.push_back(pchDeviceSerialNumber);
+        pDriver->Activate(index);
+        return true;
+    }
+    virtual void TrackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t& newPose, uint32_t unPoseStructSize) override {
+        if (unPoseStructSize != sizeof(vr::DriverPose_t)) replay.result->badStructSizes++;
+        const std::string serial = unWhichDevice < serials.size() ? serials[unWhichDevice] : "index " + std::to_string(unWhichDevice);
+        replay.result->poses[serial].push_back({ replay.frame, newPose });
+    }
+    virtual void VsyncEvent(double vsyncTimeOffsetSeconds) override {}
+    virtual void VendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t& eventData, double eventTimeOffset) override {}
+    virtual bool IsExiting() override { return false; }
+    virtual bool PollNextEvent(vr::VREvent_t* pEvent, uint32_t uncbVREvent) override { return false; }
+    virtual void GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, vr::TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override {
+        for (uint32_t i = 0; i < unTrackedDevicePoseArrayCount; i++) {
+            pTrackedDevicePoseArray[i] = {};
+        }
+        if (unTrackedDevicePoseArrayCount > 0) pTrackedDevicePoseArray[0].mDeviceToAbsoluteTracking = HmdPose(replay.frame);
+    }
+    virtual void RequestRestart(const char* pchLocalizedReason, const char* pchExecutableToStart, const char* pchArguments, const char* pchWorkingDirectory) override {}
+    virtual uint32_t GetFrameTimings(vr::Compositor_FrameTiming* pTiming, uint32_t nFrames) override { return 0; }
+    virtual void SetDisplayEyeToHead(uint32_t unWhichDevice, const vr::HmdMatrix34_t& eyeToHeadLeft, const vr::HmdMatrix34_t& eyeToHeadRight) override {}
+    virtual void SetDisplayProjectionRaw(uint32_t unWhichDevice, const vr::HmdRect2_t& eyeLeft, const vr::HmdRect2_t& eyeRight) override {}
+    virtual void SetRecommendedRenderTargetSize(uint32_t unWhichDevice, uint32_t nWidth, uint32_t nHeight) override {}
+};
+
+/// Serves the HMD's universe and driver provided chaperone, when there is one
+class FakeProperties : public vr::IVRProperties {
+public:
+    static constexpr vr::PropertyContainerHandle_t HMD_CONTAINER = 100;
+    static constexpr uint64_t UNIVERSE_ID = 7;
+
+    std::optional<std::string> chaperonePath;
+
+    virtual vr::ETrackedPropertyError ReadPropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyRead_t* pBatch, uint32_t unBatchEntryCount) override {
+        for (uint32_t i = 0; i < unBatchEntryCount; i++) {
+            vr::PropertyRead_t& read = pBatch[i];
+            read.eError = vr::TrackedProp_UnknownProperty;
+            read.unTag = vr::k_unInvalidPropertyTag;
+            read.unRequiredBufferSize = 0;
+            if (ulContainerHandle != HMD_CONTAINER || !chaperonePath) continue;
+
+            if (read.prop == vr::Prop_CurrentUniverseId_Uint64) {
+                Write(read, vr::k_unUint64PropertyTag, &UNIVERSE_ID, sizeof(UNIVERSE_ID));
+            } else if (read.prop == vr::Prop_DriverProvidedChaperonePath_String) {
+                Write(read, vr::k_unStringPropertyTag, chaperonePath->c_str(), static_cast<uint32_t>(chaperonePath->size() + 1));
+            }
+        }
+        return vr::TrackedProp_Success;
+    }
+    virtual vr::ETrackedPropertyError WritePropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyWrite_t* pBatch, uint32_t unBatchEntryCount) override { return vr::TrackedProp_Success; }
+    virtual const char* GetPropErrorNameFromEnum(vr::ETrackedPropertyError error) override { return "error"; }
+    virtual vr::PropertyContainerHandle_t TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) override { return HMD_CONTAINER + nDevice; }
+
+private:
+    static void Write(vr::PropertyRead_t& read, vr::PropertyTypeTag_t tag, const void* value, uint32_t size) {
+        read.unTag = tag;
+        read.unRequiredBufferSize = size;
+        if (read.unBufferSize < size) {
+            read.eError = vr::TrackedProp_BufferTooSmall;
+            return;
+        }
+        std::memcpy(read.pvBuffer, value, size);
+        read.eError = vr::TrackedProp_Success;
+    }
+};
+
+/// Settings with strict types: a key only reads back as the type it was set with
+class FakeSettings : public vr::IVRSettings {
+public:
+    std::map<std::string, std::variant<bool, int32_t, float, std::string>> values;
+
+    virtual const char* GetSettingsErrorNameFromEnum(vr::EVRSettingsError eError) override { return "error"; }
+    virtual void SetBool(const char* pchSection, const char* pchSettingsKey, bool bValue, vr::EVRSettingsError* peError) override { Set(pchSection, pchSettingsKey, bValue, peError); }
+    virtual void SetInt32(const char* pchSection, const char* pchSettingsKey, int32_t nValue, vr::EVRSettingsError* peError) override { Set(pchSection, pchSettingsKey, nValue, peError); }
+    virtual void SetFloat(const char* pchSection, const char* pchSettingsKey, float flValue, vr::EVRSettingsError* peError) override { Set(pchSection, pchSettingsKey, flValue, peError); }
+    virtual void SetString(const char* pchSection, const char* pchSettingsKey, const char* pchValue, vr::EVRSettingsError* peError) override {
+        if (std::strcmp(pchSection, vr::k_pch_Trackers_Section) == 0 && replay.result) replay.result->viveRoles++;
+        Set(pchSection, pchSettingsKey, std::string(pchValue), peError);
+    }
+    virtual bool GetBool(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError) override { return Get<bool>(pchSection, pchSettingsKey, peError).value_or(false); }
+    virtual int32_t GetInt32(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError) override { return Get<int32_t>(pchSection, pchSettingsKey, peError).value_or(0); }
+    virtual float GetFloat(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError) override { return Get<float>(pchSection, pchSettingsKey, peError).value_or(0.0f); }
+    virtual void GetString(const char* pchSection, const char* pchSettingsKey, char* pchValue, uint32_t unValueLen, vr::EVRSettingsError* peError) override {
+        const std::string value = Get<std::string>(pchSection, pchSettingsKey, peError).value_or("");
+        if (unValueLen == 0) return;
+        const size_t len = std::min<size_t>(value.size(), unValueLen - 1);
+        std::memcpy(pchValue, value.data(), len);
+        pchValue[len] = '\0';
+    }
+    virtual void RemoveSection(const char* pchSection, vr::EVRSettingsError* peError) override {}
+    virtual void RemoveKeyInSection(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError) override {
+        values.erase(std::string(pchSection) + "/" + pchSettingsKey);
+    }
+
+private:
+    template <typename T>
+    void Set(const char* pchSection, const char* pchSettingsKey, T value, vr::EVRSettingsError* peError) {
+        values[std::string(pchSection) + "/" + pchSettingsKey] = value;
+        if (peError) *peError = vr::VRSettingsError_None;
+    }
+
+    template <typename T>
+    std::optional<T> Get(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError) {
+        const auto value = values.find(std::string(pchSection) + "/" + pchSettingsKey);
+        vr::EVRSettingsError error = vr::VRSettingsError_None;
+        std::optional<T> result;
+        if (value == values.end()) {
+            error = vr::VRSettingsError_UnsetSettingHasNoDefault;
+        } else if (!std::holds_alternative<T>(value->second)) {
+            error = vr::VRSettingsError_ReadFailed;
+        } else {
+            result = std::get<T>(value->second);
+        }
+        if (peError) *peError = error;
+        return result;
+    }
+};
+
+class FakeDriverLog : public vr::IVRDriverLog {
+public:
+    virtual void Log(const char* pchLogMessage) override {}
+};
+
+class FakeDriverContext : public vr::IVRDriverContext {
+public:
+    FakeServerDriverHost host;
+    FakeProperties properties;
+    FakeSettings settings;
+    FakeDriverLog log;
+
+    virtual void* GetGenericInterface(const char* pchInterfaceVersion, vr::EVRInitError* peError) override {
+        void* result = nullptr;
+        if (std::strcmp(pchInterfaceVersion, vr::IVRServerDriverHost_Version) == 0) result = static_cast<vr::IVRServerDriverHost*>(&host);
+        else if (std::strcmp(pchInterfaceVersion, vr::IVRProperties_Version) == 0) result = static_cast<vr::IVRProperties*>(&properties);
+        else if (std::strcmp(pchInterfaceVersion, vr::IVRSettings_Version) == 0) result = static_cast<vr::IVRSettings*>(&settings);
+        else if (std::strcmp(pchInterfaceVersion, vr::IVRDriverLog_Version) == 0) result = static_cast<vr::IVRDriverLog*>(&log);
+        if (peError) *peError = result ? vr::VRInitError_None : vr::VRInitError_Init_InterfaceNotFound;
+        return result;
+    }
+    virtual vr::DriverHandle_t GetDriverHandle() override { return 1; }
+};
+
+/// The OpenVR interface accessors cache what the first context hands out, so every run shares this one
+FakeDriverContext context;
+
+/// Runs the traffic through a fresh VRDriver, one RunFrame per frame in the traffic
+RunResult RunDriver(const Traffic& traffic, std::optional<std::string> chaperonePath, bool fastHmdPoseEncoding, const std::string& recordPath) {
+    RunResult result;
+    context.host.serials = { "HMD" };
+    context.properties.chaperonePath = chaperonePath;
+    context.settings.values.clear();
+    context.settings.values["driver_slimevr/fastHmdPoseEncoding"] = fastHmdPoseEncoding;
+    context.settings.values["driver_slimevr/recordBridgeTraffic"] = recordPath;
+    replay = { &traffic, 0, 0, &result };
+
+    replayDriver = std::make_shared<SlimeVRDriver::VRDriver>();
+    if (replayDriver->Init(&context) == vr::VRInitError_None) {
+        while (replay.offset < traffic.size()) {
+            result.sent.emplace_back();
+            replayDriver->RunFrame();
+            replay.frame++;
+        }
+        replayDriver->Cleanup();
+    } else {
+        std::printf("replay: driver init failed\n");
+    }
+    // the driver closes its recording on destruction
+    replayDriver.reset();
+    replay = {};
+    return result;
+}
+
+constexpr double POSITION_TOLERANCE = 1e-5; // metres
+constexpr double ROTATION_TOLERANCE = 1e-5; // quaternion components
+constexpr int MAX_REPORTS = 10;
+
+bool Near(double a, double b, double tolerance) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    return std::fabs(a - b) <= tolerance;
+}
+
+/// @return name of the first field that differs, nullptr if the poses match within tolerance
+const char* DiffPose(const vr::DriverPose_t& expected, const vr::DriverPose_t& actual) {
+    for (int i = 0; i < 3; i++) {
+        if (!Near(expected.vecPosition[i], actual.vecPosition[i], POSITION_TOLERANCE)) return "vecPosition";
+        if (!Near(expected.vecVelocity[i], actual.vecVelocity[i], POSITION_TOLERANCE)) return "vecVelocity";
+        if (!Near(expected.vecAcceleration[i], actual.vecAcceleration[i], POSITION_TOLERANCE)) return "vecAcceleration";
+        if (!Near(expected.vecAngularVelocity[i], actual.vecAngularVelocity[i], ROTATION_TOLERANCE)) return "vecAngularVelocity";
+        if (!Near(expected.vecAngularAcceleration[i], actual.vecAngularAcceleration[i], ROTATION_TOLERANCE)) return "vecAngularAcceleration";
+        if (!Near(expected.vecWorldFromDriverTranslation[i], actual.vecWorldFromDriverTranslation[i], POSITION_TOLERANCE)) return "vecWorldFromDriverTranslation";
+        if (!Near(expected.vecDriverFromHeadTranslation[i], actual.vecDriverFromHeadTranslation[i], POSITION_TOLERANCE)) return "vecDriverFromHeadTranslation";
+    }
+    const std::pair<const char*, std::pair<vr::HmdQuaternion_t, vr::HmdQuaternion_t>> rotations[] = {
+        { "qRotation", { expected.qRotation, actual.qRotation } },
+        { "qWorldFromDriverRotation", { expected.qWorldFromDriverRotation, actual.qWorldFromDriverRotation } },
+        { "qDriverFromHeadRotation", { expected.qDriverFromHeadRotation, actual.qDriverFromHeadRotation } },
+    };
+    for (const auto& [name, q] : rotations) {
+        if (!Near(q.first.w, q.second.w, ROTATION_TOLERANCE) || !Near(q.first.x, q.second.x, ROTATION_TOLERANCE)
+            || !Near(q.first.y, q.second.y, ROTATION_TOLERANCE) || !Near(q.first.z, q.second.z, ROTATION_TOLERANCE)) return name;
+    }
+    if (expected.result != actual.result) return "result";
+    if (expected.poseIsValid != actual.poseIsValid) return "poseIsValid";
+    if (expected.deviceIsConnected != actual.deviceIsConnected) return "deviceIsConnected";
+    if (expected.willDriftInYaw != actual.willDriftInYaw) return "willDriftInYaw";
+    if (expected.shouldApplyHeadModel != actual.shouldApplyHeadModel) return "shouldApplyHeadModel";
+    return nullptr;
+}
+
+/// Reports divergences by tracker and driver frame
+int ComparePoses(const char* run, const Capture& expected, const Capture& actual) {
+    std::vector<std::string> serials;
+    for (const auto& [serial, poses] : expected) serials.push_back(serial);
+    for (const auto& [serial, poses] : actual) {
+        if (!expected.count(serial)) serials.push_back(serial);
+    }
+
+    int divergences = 0;
+    for (const auto& serial : serials) {
+        static const std::vector<SubmittedPose> none;
+        const auto e = expected.find(serial);
+        const auto a = actual.find(serial);
+        const auto& expectedPoses = e != expected.end() ? e->second : none;
+        const auto& actualPoses = a != actual.end() ? a->second : none;
+
+        int trackerDivergences = 0;
+        if (expectedPoses.size() != actualPoses.size()) {
+            std::printf("%s: tracker %s: %zu poses submitted (expected %zu)\n", run, serial.c_str(), actualPoses.size(), expectedPoses.size());
+            trackerDivergences++;
+        }
+        const size_t count = std::min(expectedPoses.size(), actualPoses.size());
+        for (size_t n = 0; n < count; n++) {
+            const SubmittedPose& want = expectedPoses[n];
+            const SubmittedPose& got = actualPoses[n];
+            const char* field = got.frame != want.frame ? "frame" : DiffPose(want.pose, got.pose);
+            if (!field) continue;
+            if (trackerDivergences < MAX_REPORTS)
+                std::printf("%s: tracker %s frame %d: %s differs\n", run, serial.c_str(), want.frame, field);
+            trackerDivergences++;
+        }
+        if (trackerDivergences > 0)
+            std::printf("%s: tracker %s: %d of %zu poses diverge\n", run, serial.c_str(), trackerDivergences, expectedPoses.size());
+        divergences += trackerDivergences;
+    }
+    return divergences;
+}
+
+/// @return index of the first differing byte, -1 if the streams are equal
+long FirstDifference(const Traffic& expected, const Traffic& actual) {
+    const auto mismatch = std::mismatch(expected.begin(), expected.end(), actual.begin(), actual.end());
+    if (mismatch.first == expected.end() && mismatch.second == actual.end()) return -1;
+    return static_cast<long>(std::distance(expected.begin(), mismatch.first));
+}
+
+/// Reports frames where the bytes sent to the server differ
+int CompareSent(const char* run, const std::vector<Traffic>& expected, const std::vector<Traffic>& actual) {
+    int divergences = 0;
+    if (expected.size() != actual.size()) {
+        std::printf("%s: sent in %zu frames (expected %zu)\n", run, actual.size(), expected.size());
+        divergences++;
+    }
+    const size_t frames = std::min(expected.size(), actual.size());
+    for (size_t frame = 0; frame < frames; frame++) {
+        const long byte = FirstDifference(expected[frame], actual[frame]);
+        if (byte < 0) continue;
+        if (divergences < MAX_REPORTS)
+            std::printf("%s: sent frame %zu: byte %ld differs (%zu bytes, expected %zu)\n", run, frame, byte, actual[frame].size(), expected[frame].size());
+        divergences++;
+    }
+    return divergences;
+}
+
+/// @return number of driver frames in the traffic, -1 if it is malformed
+int CountFrames(const Traffic& traffic) {
+    messages::ProtobufMessage message;
+    int frames = 0;
+    bool pending = false;
+    auto it = traffic.begin();
+    while (it != traffic.end()) {
+        const auto remaining = static_cast<int>(std::distance(it, traffic.end()));
+        int msgSize = 0;
+        const std::optional msgBegin = ReadBridgeHeader(it, remaining, msgSize);
+        if (!msgBegin || msgSize > remaining - BRIDGE_HEADER_SIZE) {
+            std::printf("replay: truncated message at byte %td\n", std::distance(traffic.begin(), it));
+            return -1;
+        }
+        if (!message.ParseFromArray(&(**msgBegin), msgSize)) {
+            std::printf("replay: failed to parse message at byte %td\n", std::distance(traffic.begin(), it));
+            return -1;
+        }
+        if (msgSize == 0) {
+            frames++;
+            pending = false;
+        } else {
+            pending = true;
+        }
+        it = *msgBegin + msgSize;
+    }
+    return pending ? frames + 1 : frames;
+}
+
+/// Normalised rotation from yaw and pitch
+messages::Position MakePosition(int trackerId, float yaw, float pitch, bool withPosition) {
+    messages::Position pos;
+    pos.set_tracker_id(trackerId);
+    const float cy = std::cos(yaw / 2), sy = std::sin(yaw / 2);
+    const float cp = std::cos(pitch / 2), sp = std::sin(pitch / 2);
+    pos.set_qw(cy * cp);
+    pos.set_qx(cy * sp);
+    pos.set_qy(sy * cp);
+    pos.set_qz(-sy * sp);
+    if (withPosition) {
+        pos.set_x(0.3f * std::sin(yaw));
+        pos.set_y(1.0f + 0.1f * std::sin(pitch));
+        pos.set_z(0.3f * std::cos(yaw));
+        pos.set_data_source(messages::Position_DataSource_FULL);
+    } else {
+        pos.set_data_source(messages::Position_DataSource_IMU);
+    }
+    return pos;
+}
+
+void AppendTrackerAdded(int id, TrackerRole role, const std::string& serial, Traffic& traffic) {
+    messages::ProtobufMessage message;
+    messages::TrackerAdded* ta = message.mutable_tracker_added();
+    ta->set_tracker_id(id);
+    ta->set_tracker_role(role);
+    ta->set_tracker_serial(serial);
+    ta->set_tracker_name("Tracker " + std::to_string(id));
+    AppendFrame(message, traffic);
+}
+
+/// A body of trackers moving for a few seconds, with rotation-only updates, status changes,
+/// a controller the driver filters out, a tracker re-added under a new id, a plain re-add,
+/// traffic for a tracker that was never added and a few frames without messages
+Traffic SyntheticTraffic() {
+    Traffic traffic;
+    messages::ProtobufMessage message;
+    // mostly roles with a vive role, Activate writes those to the trackers settings
+    const std::pair<int, TrackerRole> trackers[] = {
+        { 3, WAIST }, { 4, LEFT_FOOT }, { 5, RIGHT_FOOT }, { 6, LEFT_KNEE }, { 8, CHEST }, { 9, NONE }, { 10, LEFT_CONTROLLER },
+    };
+    for (const auto& [id, role] : trackers) {
+        AppendTrackerAdded(id, role, "human://" + std::to_string(id), traffic);
+    }
+
+    for (int frame = 0; frame < 600; frame++) {
+        if (frame < 120 || frame >= 130) {
+            for (const auto& [id, role] : trackers) {
+                // from frame 400 on the server talks to the right foot by its new id
+                const int sentId = id == 5 && frame > 400 ? 11 : id;
+                const float t = frame / 90.0f + id;
+                *message.mutable_position() = MakePosition(sentId, std::sin(t) * 3.0f, std::cos(t * 0.7f), id != 9 || frame % 4 != 0);
+                AppendFrame(message, traffic);
+            }
+        }
+        if (frame == 100) {
+            *message.mutable_position() = MakePosition(99, 0.0f, 0.0f, true);
+            AppendFrame(message, traffic);
+        }
+        if (frame == 200 || frame == 260 || frame == 300 || frame == 330) {
+            messages::TrackerStatus* status = message.mutable_tracker_status();
+            status->set_tracker_id(frame < 300 ? 4 : 8);
+            status->set_status(frame == 200 ? messages::TrackerStatus_Status_DISCONNECTED
+                : frame == 300 ? messages::TrackerStatus_Status_BUSY
+                : messages::TrackerStatus_Status_OK);
+            AppendFrame(message, traffic);
+        }
+        if (frame == 400) AppendTrackerAdded(11, RIGHT_FOOT, "human://5", traffic);
+        if (frame == 450) AppendTrackerAdded(3, WAIST, "human://3", traffic);
+        AppendFrame(messages::ProtobufMessage::default_instance(), traffic);
+    }
+    return traffic;
+}
+
+int RunReplay(const char* recording) {
+    Traffic traffic;
+    if (recording) {
+        std::ifstream file(recording, std::ios::binary);
+        if (!file) {
+            std::printf("replay: can't open %s\n", recording);
+            return 2;
+        }
+        traffic.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        traffic = SyntheticTraffic();
+    }
+    const int frames = CountFrames(traffic);
+    if (frames < 0) return 2;
+
+    const std::filesystem::path tmp = std::filesystem::temp_directory_path();
+    const std::string chaperonePath = (tmp / "slimevr_equivalence.vrchap").string();
+    const std::string recordPath = (tmp / "slimevr_equivalence.bridge").string();
+    {
+        std::ofstream chaperone(chaperonePath, std::ios::trunc);
+        chaperone << R"({"universes":[{"universeID":")" << FakeProperties::UNIVERSE_ID
+                  << R"(","standing":{"translation":[0.5,0,-1.25],"yaw":0.75}}]})";
+    }
+
+    const std::pair<const char*, std::optional<std::string>> scenarios[] = {
+        { "no universe", std::nullopt },
+        { "universe", chaperonePath },
+    };
+
+    int divergences = 0;
+    for (const auto& [run, chaperone] : scenarios) {
+        const RunResult expected = RunDriver(traffic, chaperone, false, recordPath);
+        const RunResult actual = RunDriver(traffic, chaperone, true, "");
+
+        int runDivergences = ComparePoses(run, expected.poses, actual.poses);
+        runDivergences += CompareSent(run, expected.sent, actual.sent);
+        if (expected.badStructSizes + actual.badStructSizes > 0) {
+            std::printf("%s: %d poses submitted with a wrong struct size\n", run, expected.badStructSizes + actual.badStructSizes);
+            runDivergences++;
+        }
+        // otherwise both runs took the same path and the comparison proves nothing
+        if (expected.preEncodedFrames != 0 || (frames > 0 && actual.preEncodedFrames == 0)) {
+            std::printf("%s: fastHmdPoseEncoding not honoured, %d/%d pre-encoded frames\n", run, expected.preEncodedFrames, actual.preEncodedFrames);
+            runDivergences++;
+        }
+        // the reference run recorded what it received, which has to be the traffic itself
+        std::ifstream file(recordPath, std::ios::binary);
+        const Traffic recorded { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+        if (const long byte = FirstDifference(traffic, recorded); byte >= 0) {
+            std::printf("%s: recording differs from the traffic at byte %ld\n", run, byte);
+            runDivergences++;
+        }
+
+        size_t submitted = 0;
+        for (const auto& [serial, poses] : expected.poses) submitted += poses.size();
+        std::printf("%s: %d frames, %zu trackers, %zu poses, %d vive roles, %d pre-encoded / %d generic HMD frames, %d divergences\n",
+            run, frames, expected.poses.size(), submitted, expected.viveRoles, actual.preEncodedFrames, actual.genericHmdPositions, runDivergences);
+        divergences += runDivergences;
+    }
+
+    std::filesystem::remove(chaperonePath);
+    std::filesystem::remove(recordPath);
+    return divergences == 0 ? 0 : 1;
+}
+
+}
+
+std::shared_ptr<SlimeVRDriver::IVRDriver> SlimeVRDriver::GetDriver() {
+    return replayDriver;
+}
+
+//-----------------------------------------------------------------------------
+// In-memory bridge: serves the replayed traffic frame by frame and captures
+// what the driver sends, in place of the pipe and socket transports
+//-----------------------------------------------------------------------------
+
+BridgeStatus runBridgeFrame(SlimeVRDriver::VRDriver& driver) {
+    return BRIDGE_CONNECTED;
+}
+
+bool getNextBridgeMessage(messages::ProtobufMessage& message, SlimeVRDriver::VRDriver& driver) {
+    const Traffic& traffic = *replay.traffic;
+    if (replay.offset >= traffic.size()) return false;
+
+    // CountFrames already checked the traffic is well formed
+    int msgSize = 0;
+    const auto msgBegin = *ReadBridgeHeader(traffic.begin() + replay.offset, static_cast<int>(traffic.size() - replay.offset), msgSize);
+    replay.offset += BRIDGE_HEADER_SIZE + msgSize;
+    if (msgSize == 0) return false; // end of this driver frame
+    return message.ParseFromArray(&(*msgBegin), msgSize);
+}
+
+bool sendBridgeMessage(messages::ProtobufMessage& message, SlimeVRDriver::VRDriver& driver) {
+    if (message.has_position()) replay.result->genericHmdPositions++;
+    return AppendFrame(message, replay.result->sent.back());
+}
+
+bool sendBridgeFrame(const uint8_t* frame, int size, SlimeVRDriver::VRDriver& driver) {
+    replay.result->preEncodedFrames++;
+    Traffic& sent = replay.result->sent.back();
+    sent.insert(sent.end(), frame, frame + size);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "hmd-encoder") return RunHmdEncoder();
+    if (mode == "replay") return RunReplay(argc > 2 ? argv[2] : nullptr);
+
+    std::printf("usage: %s hmd-encoder | replay [recording]\n", argc > 0 ? argv[0] : "EquivalenceHarness");
+    return 2;
+}